@@ -1,18 +1,53 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <graphviz/cgraph.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "grafo.h"
 
+/* Número de contextos de busca reservados em cada grafo, além de um por thread do OpenMP */
+#define N_CONTEXTOS 64
+/* Tamanho de uma linha de cache, usado para separar as posições do conjunto de contextos */
+#define TAMANHO_LINHA_CACHE 64
+
+/* Lado dos blocos da matriz de distâncias no Floyd-Warshall (os três blocos usados cabem na cache L2) */
+#define FW_BLOCO 64
+/* Valor que representa "infinito" na matriz de trabalho do Floyd-Warshall */
+#define FW_INFINITO (INT_MAX / 2)
+/* Número máximo de vértices para o qual o Floyd-Warshall é considerado */
+#define FW_MAX_VERTICES 4096
+/* Quantas atualizações do Floyd-Warshall vetorizado custam o mesmo que um arco percorrido
+   na busca em largura (estimativa para vetores de 128 bits) */
+#define FW_GANHO 5.0
+
+/* (apontador para) estrutura de dados com a memória de trabalho de uma busca */
+typedef struct contexto *contexto;
+
 /* Protótipos das funções utilizadas */
 int encontra_vertice(vertice, unsigned int, const char *);
 vertice obter_vertices(Agraph_t *, unsigned int *);
 long int *obter_matriz_adjacencia(Agraph_t *, vertice, int, int, unsigned int);
-void multiplicar_matriz_quadrada(long int **, long int *, unsigned int);
-void somar_matriz_quadrada(long int *, long int *, unsigned int);
-long int _obter_distancia(grafo, unsigned int, unsigned int, long int);
-long int obter_distancia(grafo, unsigned int, unsigned int);
+unsigned int *obter_lista_adjacencia(long int *, unsigned int, int, unsigned int **);
+int construir_listas_adjacencia(grafo);
+int construir_conjunto_contextos(grafo);
+contexto cria_contexto(unsigned int);
+void destroi_contexto(contexto);
+contexto obter_contexto(grafo, int *);
+void devolver_contexto(grafo, contexto, int);
+int reservar_paralelismo(grafo);
+void liberar_paralelismo(grafo, int);
+unsigned int busca_largura(contexto, unsigned int *, unsigned int *, unsigned int, unsigned int);
+long int distancia_contexto(contexto, unsigned int);
+void floyd_warshall_bloco(int *, unsigned int, unsigned int, unsigned int, unsigned int);
+long int *floyd_warshall_matriz_distancias(grafo, int);
+long int *busca_matriz_distancias(grafo, int);
+unsigned int n_threads(int);
+int usar_floyd_warshall(grafo, int);
 long int *gerar_matriz_distancias(grafo);
 
 //------------------------------------------------------------------------------
@@ -22,9 +57,32 @@ typedef struct grafo {
   char *grafo_nome;
   long int *grafo_matriz;
   vertice grafo_vertices;
+  unsigned int *grafo_adjacencia;
+  unsigned int *grafo_adjacencia_inicio;
+  unsigned int *grafo_reversa;
+  unsigned int *grafo_reversa_inicio;
+  struct posicao_contexto *grafo_contextos;
+  volatile long int grafo_em_paralelo;
+  unsigned int grafo_n_contextos;
   unsigned int grafo_n_vertices;
 } *grafo;
 
+//------------------------------------------------------------------------------
+struct posicao_contexto {
+  contexto contexto;
+  volatile long int ocupado;
+  char preenchimento[TAMANHO_LINHA_CACHE - sizeof(contexto) - sizeof(long int)];
+};
+
+//------------------------------------------------------------------------------
+struct contexto {
+  unsigned int *contexto_marca;
+  unsigned int *contexto_fila;
+  long int *contexto_distancia;
+  unsigned int contexto_geracao;
+  unsigned int contexto_n_vertices;
+};
+
 //------------------------------------------------------------------------------
 typedef struct vertice {
   char *vertice_nome;
@@ -33,6 +91,13 @@ typedef struct vertice {
 //------------------------------------------------------------------------------
 const long int infinito = LONG_MAX;
 
+//------------------------------------------------------------------------------
+/* Próxima posição inicial entregue a uma thread que ainda não consultou nenhum grafo */
+static volatile unsigned int proximo_contexto_inicial = 0;
+
+/* Posição do conjunto de contextos por onde a thread começa a procurar (-1 se ainda não definida) */
+static __thread int contexto_preferido = -1;
+
 //------------------------------------------------------------------------------
 int encontra_vertice(vertice vertices, unsigned int n_vertices, const char *nome) {
   unsigned int i;
@@ -128,144 +193,465 @@ long int *obter_matriz_adjacencia(Agraph_t *g, vertice lista_vertices, int grafo
   return matriz;
 }
 //------------------------------------------------------------------------------
-void multiplicar_matriz_quadrada(long int **matriz, long int *mult, unsigned int tamanho) {
-  long int *matriz_resultado, *aux = *matriz;
-  unsigned int i, j, k;
+unsigned int *obter_lista_adjacencia(long int *matriz, unsigned int n_vertices, int reversa, unsigned int **inicio) {
+  unsigned int *adjacencia, i, j, n_arcos;
+  long int valor;
 
-  /* Aloca espaço para matriz resultado */
-  matriz_resultado = (long int *) malloc(sizeof(long int) * tamanho * tamanho);
+  /* Aloca o vetor de início da vizinhança de cada vértice (n_vertices + 1 posições) */
+  *inicio = (unsigned int *) malloc(sizeof(unsigned int) * (n_vertices + 1));
 
-  if(matriz_resultado != NULL) {
-    /* Percorre todos os indices da matriz resultado */
-    for(i = 0; i < tamanho; ++i) {
-      for(j = 0; j < tamanho; ++j) {
-        /* Define matriz_resultado[i,j] como 0 (valor neutro da adição) */
-        matriz_resultado[i * tamanho + j] = 0;
+  if(*inicio == NULL) {
+    return NULL;
+  }
 
-        /* Soma em matriz_resultado[i,j] o produto de M[i,k] com M[k,j],
-           para todo k inteiro no intervalo [0,tamanho] */
-        for(k = 0; k < tamanho; ++k) {
-          matriz_resultado[i * tamanho + j] += (*matriz)[i * tamanho + k] * mult[k * tamanho + j];
-        }
+  /* Conta os arcos da matriz para dimensionar a lista de adjacência. Valores infinitos
+     (na matriz do grafo de distâncias) indicam que não há arco entre os vértices */
+  for(i = 0, n_arcos = 0; i < n_vertices * n_vertices; ++i) {
+    if(matriz[i] != 0 && matriz[i] != infinito) {
+      ++n_arcos;
+    }
+  }
+
+  /* Aloca ao menos uma posição, para não confundir grafos sem arcos com erro */
+  adjacencia = (unsigned int *) malloc(sizeof(unsigned int) * (n_arcos > 0 ? n_arcos : 1));
+
+  if(adjacencia == NULL) {
+    free(*inicio);
+    *inicio = NULL;
+    return NULL;
+  }
+
+  /* Os vizinhos de i ficam em adjacencia[inicio[i]] até adjacencia[inicio[i+1]-1].
+     Na lista reversa, os vizinhos de i são as caudas dos arcos que chegam em i */
+  for(i = 0, n_arcos = 0; i < n_vertices; ++i) {
+    (*inicio)[i] = n_arcos;
+
+    for(j = 0; j < n_vertices; ++j) {
+      valor = reversa ? matriz[j * n_vertices + i] : matriz[i * n_vertices + j];
+
+      if(valor != 0 && valor != infinito) {
+        adjacencia[n_arcos++] = j;
       }
     }
+  }
+
+  (*inicio)[n_vertices] = n_arcos;
+
+  return adjacencia;
+}
+//------------------------------------------------------------------------------
+int construir_listas_adjacencia(grafo g) {
+  /* Lista de adjacência de saída, lida por todas as buscas e nunca alterada depois */
+  g->grafo_adjacencia = obter_lista_adjacencia(g->grafo_matriz, g->grafo_n_vertices, 0, &(g->grafo_adjacencia_inicio));
+
+  if(g->grafo_adjacencia == NULL) {
+    return 0;
+  }
 
-    /* Guarda o endereço da matriz resultado no ponteiro, e libera a matriz anterior */
-    *matriz = matriz_resultado;
-    free(aux);
+  /* Em grafos direcionados também é necessária a lista de entrada,
+     para verificar se todos os vértices alcançam a origem da busca */
+  if(g->grafo_direcionado) {
+    g->grafo_reversa = obter_lista_adjacencia(g->grafo_matriz, g->grafo_n_vertices, 1, &(g->grafo_reversa_inicio));
+
+    if(g->grafo_reversa == NULL) {
+      return 0;
+    }
   }
+
+  return 1;
 }
 //------------------------------------------------------------------------------
-void somar_matriz_quadrada(long int *matriz, long int *soma, unsigned int tamanho) {
-  unsigned int i;
+int construir_conjunto_contextos(grafo g) {
+  unsigned int n_contextos = N_CONTEXTOS;
+
+  /* Cada thread de uma consulta paralela reserva seu próprio contexto, portanto o
+     conjunto tem posições para todas elas além das reservadas para outras consultas */
+#ifdef _OPENMP
+  n_contextos += (unsigned int) omp_get_max_threads();
+#endif
 
-  /* Percorre todas as posições da matriz */
-  for(i = 0; i < tamanho * tamanho; ++i) {
-    /* Soma em matriz[i] o valor de soma[i] */
-    matriz[i] += soma[i];
+  g->grafo_contextos = (struct posicao_contexto *) calloc(n_contextos, sizeof(struct posicao_contexto));
+
+  if(g->grafo_contextos == NULL) {
+    return 0;
   }
+
+  g->grafo_n_contextos = n_contextos;
+
+  return 1;
 }
 //------------------------------------------------------------------------------
-long int _obter_distancia(grafo g, unsigned int i, unsigned int j, long int tentativa) {
-  long int *matriz, min, distancia;
-  unsigned int n_vertices, a;
+contexto cria_contexto(unsigned int n_vertices) {
+  contexto c;
 
-  /* Matriz de adjacência do grafo */
-  matriz = g->grafo_matriz;
-  /* Número de vértices do grafo */
-  n_vertices = g->grafo_n_vertices;
+  /* Aloca a estrutura do contexto */
+  c = (contexto) calloc(1, sizeof(struct contexto));
 
-  /* Se já tentou encontrar um passeio até j com n - 1 tentativas,
-     sendo n o número de vértices do grafo, portanto não há passeio
-     até j, logo retorna infinito */
-  if(tentativa >= n_vertices - 1) {
-    return infinito;
+  if(c != NULL) {
+    c->contexto_n_vertices = n_vertices;
+    c->contexto_marca = (unsigned int *) calloc(n_vertices + 1, sizeof(unsigned int));
+    c->contexto_fila = (unsigned int *) malloc(sizeof(unsigned int) * (n_vertices + 1));
+    c->contexto_distancia = (long int *) malloc(sizeof(long int) * (n_vertices + 1));
+
+    /* Se alguma alocação falhou, desaloca o que foi alocado e retorna erro */
+    if(c->contexto_marca == NULL || c->contexto_fila == NULL || c->contexto_distancia == NULL) {
+      destroi_contexto(c);
+      return NULL;
+    }
   }
 
-  /* Se M[i,j] não é nulo, então M[i,j] é a distância entre i e j */
-  if(matriz[i * n_vertices + j] != 0) {
-    return matriz[i * n_vertices + j];
+  return c;
+}
+//------------------------------------------------------------------------------
+void destroi_contexto(contexto c) {
+  if(c != NULL) {
+    free(c->contexto_marca);
+    free(c->contexto_fila);
+    free(c->contexto_distancia);
+    free(c);
+  }
+}
+//------------------------------------------------------------------------------
+contexto obter_contexto(grafo g, int *posicao) {
+  unsigned int i, inicio, tentativa;
+
+  /* Cada thread começa a procurar em uma posição diferente, para que threads
+     concorrentes não disputem as mesmas linhas de cache. A posição inicial é
+     obtida uma única vez por thread, e depois passa a ser a última reservada */
+  if(contexto_preferido == -1) {
+    contexto_preferido = (int) __sync_fetch_and_add(&proximo_contexto_inicial, 1);
   }
 
-  /* Percorre todos os vértices do grafo */
-  for(a = 0; a < n_vertices && a != i; ++a) {
-    /* Se a é um vértice adjacente a i, então busca a distância entre
-       a e j, e assim, recursivamente, até encontrar um vértice adjacente
-       a j e, posteriormente, retornar o menor valor encontrado */
-    if(matriz[i * n_vertices + a] != 0) {
-      distancia = _obter_distancia(g, a, j, tentativa + 1);
+  inicio = (unsigned int) contexto_preferido % g->grafo_n_contextos;
+
+  /* Procura uma posição livre no conjunto de contextos do grafo. A posição é
+     reservada de forma atômica, portanto cada contexto é usado por apenas uma
+     thread de cada vez, sem necessidade de travas. A escrita atômica só é tentada
+     se a posição parece livre, para não invalidar linhas de cache em uso */
+  for(tentativa = 0; tentativa < g->grafo_n_contextos; ++tentativa) {
+    i = (inicio + tentativa) % g->grafo_n_contextos;
+
+    if(!__atomic_load_n(&(g->grafo_contextos[i].ocupado), __ATOMIC_RELAXED) && __sync_lock_test_and_set(&(g->grafo_contextos[i].ocupado), 1) == 0) {
+      contexto_preferido = (int) i;
+
+      /* O contexto da posição é criado no primeiro uso e reaproveitado nos seguintes */
+      if(g->grafo_contextos[i].contexto == NULL) {
+        g->grafo_contextos[i].contexto = cria_contexto(g->grafo_n_vertices);
 
-      /* É necessário somar a distância de i à a na distância de a à j, para
-         assim obter a distância de i à j */
-      if(distancia != infinito && min > matriz[i * n_vertices + a] + distancia) {
-        min = matriz[i * n_vertices + a] + distancia;
+        if(g->grafo_contextos[i].contexto == NULL) {
+          __sync_lock_release(&(g->grafo_contextos[i].ocupado));
+          return NULL;
+        }
       }
+
+      *posicao = (int) i;
+      return g->grafo_contextos[i].contexto;
     }
   }
 
-  return min;
+  /* Se todos os contextos estão em uso, cria um contexto temporário */
+  *posicao = -1;
+  return cria_contexto(g->grafo_n_vertices);
 }
 //------------------------------------------------------------------------------
-long int obter_distancia(grafo g, unsigned int i, unsigned int j) {
-  /* Se i e j são iguais (mesmos vértices), então retorna 0 */
-  if(i == j) {
-    return 0;
+void devolver_contexto(grafo g, contexto c, int posicao) {
+  /* Contextos temporários são desalocados, os demais voltam a ficar livres */
+  if(posicao == -1) {
+    destroi_contexto(c);
+  } else {
+    __sync_lock_release(&(g->grafo_contextos[posicao].ocupado));
+  }
+}
+//------------------------------------------------------------------------------
+int reservar_paralelismo(grafo g) {
+  /* Apenas uma consulta de todos os pares de vértices de cada vez usa as threads do
+     OpenMP, as demais executam na thread que as chamou. Assim consultas concorrentes
+     não multiplicam o número de threads, nem esgotam o conjunto de contextos */
+  return __sync_bool_compare_and_swap(&(g->grafo_em_paralelo), 0, 1);
+}
+//------------------------------------------------------------------------------
+void liberar_paralelismo(grafo g, int paralelo) {
+  if(paralelo) {
+    __sync_lock_release(&(g->grafo_em_paralelo));
   }
+}
+//------------------------------------------------------------------------------
+unsigned int busca_largura(contexto c, unsigned int *inicio, unsigned int *adjacencia, unsigned int origem, unsigned int alvo) {
+  unsigned int *marca, *fila, geracao, frente, fim, u, v, a;
+  long int *distancia;
+
+  marca = c->contexto_marca;
+  fila = c->contexto_fila;
+  distancia = c->contexto_distancia;
+
+  /* Cada busca usa uma nova geração, assim um vértice está visitado se sua marca
+     é igual à geração atual, e não é preciso limpar as marcas a cada busca */
+  geracao = ++(c->contexto_geracao);
+
+  /* Se o contador de gerações deu a volta, limpa as marcas uma única vez */
+  if(geracao == 0) {
+    memset(marca, 0, sizeof(unsigned int) * c->contexto_n_vertices);
+    geracao = c->contexto_geracao = 1;
+  }
+
+  marca[origem] = geracao;
+  distancia[origem] = 0;
+  fila[0] = origem;
+  fim = 1;
 
-  /* Verifica distâncias na primeira tentativa (0) */
-  return _obter_distancia(g, i, j, 0);
+  /* Percorre os vértices em ordem de distância a partir da origem */
+  for(frente = 0; frente < fim && marca[alvo] != geracao; ++frente) {
+    u = fila[frente];
+
+    for(a = inicio[u]; a < inicio[u + 1]; ++a) {
+      v = adjacencia[a];
+
+      if(marca[v] != geracao) {
+        marca[v] = geracao;
+        distancia[v] = distancia[u] + 1;
+        fila[fim++] = v;
+      }
+    }
+  }
+
+  /* Retorna o número de vértices alcançados */
+  return fim;
 }
 //------------------------------------------------------------------------------
-long int *gerar_matriz_distancias(grafo g) {
-  long int *matriz_potencia, *matriz_distancias;
-  unsigned int n_vertices, i, j;
+long int distancia_contexto(contexto c, unsigned int v) {
+  /* Vértices não visitados na última busca não são alcançáveis a partir da origem */
+  return c->contexto_marca[v] == c->contexto_geracao ? c->contexto_distancia[v] : infinito;
+}
+//------------------------------------------------------------------------------
+void floyd_warshall_bloco(int *matriz, unsigned int tamanho, unsigned int bloco_i, unsigned int bloco_j, unsigned int bloco_k) {
+  unsigned int i, j, k;
+  int distancia_ik, soma, *linha_i;
+  const int *linha_k;
+
+  /* Relaxa o bloco (bloco_i, bloco_j) usando como intermediários os vértices do bloco_k.
+     Como as distâncias nunca passam de FW_INFINITO (INT_MAX / 2), a soma de duas delas não
+     estoura, e o mínimo com o valor atual satura a soma em FW_INFINITO */
+  for(k = bloco_k * FW_BLOCO; k < (bloco_k + 1) * FW_BLOCO; ++k) {
+    linha_k = &matriz[k * tamanho + bloco_j * FW_BLOCO];
+
+    for(i = bloco_i * FW_BLOCO; i < (bloco_i + 1) * FW_BLOCO; ++i) {
+      distancia_ik = matriz[i * tamanho + k];
+      linha_i = &matriz[i * tamanho + bloco_j * FW_BLOCO];
+
+      /* Mesmo quando linha_i e linha_k são a mesma linha (i = k) os valores não mudam,
+         pois d(k,k) = 0, portanto o laço pode ser vetorizado (soma é própria de cada posição) */
+      #pragma omp simd private(soma)
+      for(j = 0; j < FW_BLOCO; ++j) {
+        soma = distancia_ik + linha_k[j];
+        linha_i[j] = soma < linha_i[j] ? soma : linha_i[j];
+      }
+    }
+  }
+}
+//------------------------------------------------------------------------------
+long int *floyd_warshall_matriz_distancias(grafo g, int paralelo) {
+  long int *matriz_distancias;
+  int *matriz;
+  unsigned int n_vertices, tamanho, n_blocos, i, j, k;
+  unsigned int *inicio, *adjacencia;
 
   /* Número de vértices do grafo */
   n_vertices = g->grafo_n_vertices;
-  /* Matriz de potência (exponencial), irá armazenar M^1, M^2, M^3, ... M^(n_vertices-1) */
-  matriz_potencia = (long int *) malloc(sizeof(long int) * n_vertices * n_vertices);
+  inicio = g->grafo_adjacencia_inicio;
+  adjacencia = g->grafo_adjacencia;
 
-  /* Se for nula, retorna erro de alocação dinâmica */
-  if(matriz_potencia == NULL) {
-    fprintf(stderr, "gerar_matriz_distancias(): Erro ao alocar memória para matriz exponencial!\n");
+  /* O lado da matriz de trabalho é arredondado para um múltiplo do lado dos blocos */
+  n_blocos = (n_vertices + FW_BLOCO - 1) / FW_BLOCO;
+  tamanho = n_blocos * FW_BLOCO;
+
+  /* Matriz de trabalho e matriz de distâncias */
+  matriz = (int *) malloc(sizeof(int) * tamanho * tamanho);
+  matriz_distancias = (long int *) malloc(sizeof(long int) * n_vertices * n_vertices);
+
+  /* Se alguma for nula, retorna erro de alocação dinâmica */
+  if(matriz == NULL || matriz_distancias == NULL) {
+    free(matriz);
+    free(matriz_distancias);
     return NULL;
   }
 
+  /* Inicializa a matriz de trabalho com d(v,v) = 0, d(u,v) = 1 se existe o arco (u,v)
+     e FW_INFINITO nos demais valores (inclusive nos vértices de preenchimento) */
+  for(i = 0; i < tamanho; ++i) {
+    for(j = 0; j < tamanho; ++j) {
+      matriz[i * tamanho + j] = (i == j) ? 0 : FW_INFINITO;
+    }
+  }
+
+  for(i = 0; i < n_vertices; ++i) {
+    for(j = inicio[i]; j < inicio[i + 1]; ++j) {
+      if(adjacencia[j] != i) {
+        matriz[i * tamanho + adjacencia[j]] = 1;
+      }
+    }
+  }
+
+  /* Floyd-Warshall em blocos: para cada bloco k da diagonal, primeiro relaxa o próprio
+     bloco (k,k), depois os blocos da linha e da coluna k, que dependem apenas de (k,k),
+     e por fim os demais blocos, que dependem apenas da linha e da coluna k. Dentro das
+     duas últimas fases os blocos são independentes, e são processados em paralelo
+     (se paralelo não é nulo) */
+  for(k = 0; k < n_blocos; ++k) {
+    floyd_warshall_bloco(matriz, tamanho, k, k, k);
+
+    /* As iterações pares relaxam os blocos da coluna k e as ímpares os da linha k */
+    #pragma omp parallel for schedule(static) if(paralelo)
+    for(i = 0; i < 2 * n_blocos; ++i) {
+      if(i / 2 != k) {
+        if(i % 2 == 0) {
+          floyd_warshall_bloco(matriz, tamanho, i / 2, k, k);
+        } else {
+          floyd_warshall_bloco(matriz, tamanho, k, i / 2, k);
+        }
+      }
+    }
+
+    #pragma omp parallel for collapse(2) schedule(static) if(paralelo)
+    for(i = 0; i < n_blocos; ++i) {
+      for(j = 0; j < n_blocos; ++j) {
+        if(i != k && j != k) {
+          floyd_warshall_bloco(matriz, tamanho, i, j, k);
+        }
+      }
+    }
+  }
+
+  /* Copia as distâncias para a matriz de distâncias, trocando FW_INFINITO por infinito */
+  for(i = 0; i < n_vertices; ++i) {
+    for(j = 0; j < n_vertices; ++j) {
+      matriz_distancias[i * n_vertices + j] = (matriz[i * tamanho + j] < FW_INFINITO) ? matriz[i * tamanho + j] : infinito;
+    }
+  }
+
+  free(matriz);
+
+  return matriz_distancias;
+}
+//------------------------------------------------------------------------------
+long int *busca_matriz_distancias(grafo g, int paralelo) {
+  long int *matriz_distancias;
+  unsigned int n_vertices, i, j;
+  int erro = 0;
+
+  /* Número de vértices do grafo */
+  n_vertices = g->grafo_n_vertices;
+
   /* Matriz de distâncias */
   matriz_distancias = (long int *) malloc(sizeof(long int) * n_vertices * n_vertices);
 
   /* Se for nula, retorna erro de alocação dinâmica */
   if(matriz_distancias == NULL) {
-    free(matriz_potencia);
-    fprintf(stderr, "gerar_matriz_distancias(): Erro ao alocar memória para matriz de distâncias!\n");
     return NULL;
   }
 
-  /* Inicializa matriz_potencia <- M^1 e matriz_distancias <- M, sendo M a matriz de adjacência do grafo */
-  for(i = 0; i < n_vertices * n_vertices; ++i) {
-    matriz_potencia[i] = g->grafo_matriz[i];
-    matriz_distancias[i] = infinito;
-  }
+  /* A linha i da matriz de distâncias é obtida com uma busca em largura a partir de i.
+     As buscas são independentes, e (se paralelo não é nulo) são distribuídas entre as
+     threads, cada uma com seu próprio contexto de busca */
+  #pragma omp parallel private(i, j) reduction(|:erro) if(paralelo)
+  {
+    contexto c;
+    int posicao;
+
+    c = obter_contexto(g, &posicao);
+
+    #pragma omp for schedule(dynamic, 16)
+    for(i = 0; i < n_vertices; ++i) {
+      if(c == NULL) {
+        erro = 1;
+        continue;
+      }
 
-  /* Zera diagonal principal da matriz de distâncias, pois d(v,v) = 0 */
-  for(i = 0; i < n_vertices; ++i) {
-    matriz_distancias[i * n_vertices + i] = 0;
-  }
+      /* O alvo n_vertices não existe, portanto cada busca percorre todo o grafo alcançável */
+      busca_largura(c, g->grafo_adjacencia_inicio, g->grafo_adjacencia, i, n_vertices);
 
-  /* Multiplica a matriz_potencia por M aumentando seu grau, ou seja, se matriz_potencia = M^x, então
-     matriz_potencia <- M^(x+1) */
-  for(i = 0; i < n_vertices - 1; ++i) {
-    for(j = 0; j < n_vertices * n_vertices; ++j) {
-      if(matriz_potencia[j] != 0 && matriz_distancias[j] > i + 1) {
-        matriz_distancias[j] = i + 1;
+      for(j = 0; j < n_vertices; ++j) {
+        matriz_distancias[i * n_vertices + j] = distancia_contexto(c, j);
       }
     }
 
-    multiplicar_matriz_quadrada(&matriz_potencia, g->grafo_matriz, n_vertices);
+    if(c != NULL) {
+      devolver_contexto(g, c, posicao);
+    }
+  }
+
+  /* Se alguma thread não obteve contexto, a matriz está incompleta */
+  if(erro) {
+    free(matriz_distancias);
+    return NULL;
+  }
+
+  return matriz_distancias;
+}
+//------------------------------------------------------------------------------
+unsigned int n_threads(int paralelo) {
+  /* Número de threads que uma consulta paralela pode usar */
+#ifdef _OPENMP
+  if(paralelo) {
+    return (unsigned int) omp_get_max_threads();
+  }
+#else
+  (void) paralelo;
+#endif
+
+  return 1;
+}
+//------------------------------------------------------------------------------
+int usar_floyd_warshall(grafo g, int paralelo) {
+  double n_vertices, n_arcos, custo_busca, custo_floyd_warshall;
+  unsigned int n_blocos, threads, blocos_fase;
+
+  /* Acima deste limite a matriz de trabalho não cabe em uma quantidade razoável de memória */
+  if(g->grafo_n_vertices > FW_MAX_VERTICES) {
+    return 0;
+  }
+
+  /* Número de vértices, de arcos e de threads disponíveis para a consulta */
+  n_vertices = g->grafo_n_vertices;
+  n_arcos = g->grafo_adjacencia_inicio[g->grafo_n_vertices];
+  threads = n_threads(paralelo);
+
+  /* Número de blocos em cada linha da matriz de trabalho do Floyd-Warshall, cujo lado é
+     arredondado para um múltiplo de FW_BLOCO */
+  n_blocos = (g->grafo_n_vertices + FW_BLOCO - 1) / FW_BLOCO;
+
+  /* As buscas em largura custam n * (n + m), e são divididas entre as threads (no máximo
+     uma busca por thread) */
+  custo_busca = n_vertices * (n_vertices + n_arcos) / (threads < g->grafo_n_vertices ? threads : g->grafo_n_vertices);
+
+  /* O Floyd-Warshall em blocos custa FW_BLOCO^3 por bloco relaxado, dividido pelo ganho da
+     vetorização e do uso da cache (FW_GANHO). Para cada bloco k da diagonal, o bloco (k,k)
+     é relaxado por uma única thread, e os 2 * (n_blocos - 1) blocos da linha e da coluna k
+     e os (n_blocos - 1)^2 demais blocos são divididos entre as threads. Assim, grafos
+     pequenos (com poucos blocos) não aproveitam as threads disponíveis */
+  blocos_fase = 1 + (2 * (n_blocos - 1) + threads - 1) / threads + ((n_blocos - 1) * (n_blocos - 1) + threads - 1) / threads;
+  custo_floyd_warshall = (double) n_blocos * blocos_fase * FW_BLOCO * FW_BLOCO * FW_BLOCO / FW_GANHO;
+
+  /* Os pesos das arestas não alteram os custos, pois a distância é o tamanho (e não o peso)
+     dos caminhos, e as buscas em largura já são o método mais rápido para grafos esparsos */
+  return custo_floyd_warshall < custo_busca;
+}
+//------------------------------------------------------------------------------
+long int *gerar_matriz_distancias(grafo g) {
+  long int *matriz_distancias;
+  int paralelo;
+
+  /* Reserva as threads antes de escolher o método, pois o custo de cada um depende de
+     quantas threads podem ser usadas, e escolhe o método mais rápido para o tamanho e a
+     densidade do grafo */
+  paralelo = reservar_paralelismo(g);
+
+  if(usar_floyd_warshall(g, paralelo)) {
+    matriz_distancias = floyd_warshall_matriz_distancias(g, paralelo);
+  } else {
+    matriz_distancias = busca_matriz_distancias(g, paralelo);
   }
 
-  /* Libera espaço ocupado pela matriz exponencial */
-  free(matriz_potencia);
+  liberar_paralelismo(g, paralelo);
 
   return matriz_distancias;
 }
@@ -275,8 +661,8 @@ grafo le_grafo(FILE *input) {
   grafo grafo_lido;
   char peso_string[] = "peso";
 
-  /* Aloca estrutura do grafo lido */
-  grafo_lido = (grafo) malloc(sizeof(struct grafo));
+  /* Aloca estrutura do grafo lido, com todos os campos (e contextos de busca) nulos */
+  grafo_lido = (grafo) calloc(1, sizeof(struct grafo));
 
   if(grafo_lido != NULL) {
     /* Armazena em g o grafo lido da entrada */
@@ -311,12 +697,20 @@ grafo le_grafo(FILE *input) {
     }
 
     agclose(g);
+
+    /* Carrega na estrutura as listas de adjacência de g e o conjunto de contextos, usados pelas buscas */
+    if(!construir_listas_adjacencia(grafo_lido) || !construir_conjunto_contextos(grafo_lido)) {
+      destroi_grafo(grafo_lido);
+      return NULL;
+    }
   }
 
   return grafo_lido;
 }
 //------------------------------------------------------------------------------
 int destroi_grafo(grafo g) {
+  unsigned int i;
+
   if(g != NULL) {
     /* Libera a região de memória ocupada pelo nome do grafo, se não for nula */
     if(g->grafo_nome != NULL) {
@@ -325,8 +719,6 @@ int destroi_grafo(grafo g) {
 
     /* Libera a região de memória ocupada pelos vértices do grafo, se não for nula */
     if(g->grafo_vertices != NULL) {
-      unsigned int i;
-
       /* Libera os nomes de todos os vértices */
       for(i = 0; i < g->grafo_n_vertices; ++i) {
         if(g->grafo_vertices[i].vertice_nome != NULL) {
@@ -342,6 +734,21 @@ int destroi_grafo(grafo g) {
       free(g->grafo_matriz);
     }
 
+    /* Libera as listas de adjacência do grafo (free ignora apontadores nulos) */
+    free(g->grafo_adjacencia);
+    free(g->grafo_adjacencia_inicio);
+    free(g->grafo_reversa);
+    free(g->grafo_reversa_inicio);
+
+    /* Libera os contextos de busca criados pelas consultas ao grafo */
+    if(g->grafo_contextos != NULL) {
+      for(i = 0; i < g->grafo_n_contextos; ++i) {
+        destroi_contexto(g->grafo_contextos[i].contexto);
+      }
+
+      free(g->grafo_contextos);
+    }
+
     /* Libera a região de memória ocupada pela estrutura do grafo */
     free(g);
   }
@@ -403,7 +810,7 @@ grafo escreve_grafo(FILE *output, grafo g) {
 }
 //------------------------------------------------------------------------------
 char *nome(grafo g) {
-  char empty[] = "";
+  static char empty[] = "";
 
   return g ? g->grafo_nome : empty;
 }
@@ -412,6 +819,31 @@ unsigned int n_vertices(grafo g) {
   return g ? g->grafo_n_vertices : 0;
 }
 
+//------------------------------------------------------------------------------
+char *nome_vertice(grafo g, unsigned int i) {
+  return (g && i < g->grafo_n_vertices) ? g->grafo_vertices[i].vertice_nome : NULL;
+}
+
+//------------------------------------------------------------------------------
+long int peso_aresta(grafo g, const char *u, const char *v) {
+  int i, j;
+
+  /* Obtém os índices dos vértices, se algum não existe não há aresta entre eles */
+  if(g == NULL) {
+    return 0;
+  }
+
+  i = encontra_vertice(g->grafo_vertices, g->grafo_n_vertices, u);
+  j = encontra_vertice(g->grafo_vertices, g->grafo_n_vertices, v);
+
+  if(i == -1 || j == -1) {
+    return 0;
+  }
+
+  /* Valor de M[i,j], sendo M a matriz de adjacência do grafo */
+  return g->grafo_matriz[(unsigned int) i * g->grafo_n_vertices + (unsigned int) j];
+}
+
 //------------------------------------------------------------------------------
 int direcionado(grafo g) {
   return g ? g->grafo_direcionado : 0;
@@ -419,90 +851,63 @@ int direcionado(grafo g) {
 
 //------------------------------------------------------------------------------
 int conexo(grafo g) {
-  long int *matriz_potencia, *matriz_soma;
-  unsigned int n_vertices, i, j;
+  unsigned int n_vertices, alcancados;
+  contexto c;
+  int posicao;
 
   /* Número de vértices do grafo */
   n_vertices = g->grafo_n_vertices;
-  /* Matriz de potência (exponencial), irá armazenar M^1, M^2, M^3, ... M^(n_vertices-1) */
-  matriz_potencia = (long int *) malloc(sizeof(long int) * n_vertices * n_vertices);
 
-  /* Se for nula, retorna erro de alocação dinâmica */
-  if(matriz_potencia == NULL) {
-    fprintf(stderr, "conexo(): Erro ao alocar memória para matriz exponencial!\n");
+  /* Obtém um contexto de busca livre, se não houver memória retorna erro */
+  if((c = obter_contexto(g, &posicao)) == NULL) {
     return -1;
   }
 
-  /* Matriz de soma (acumulativa), irá armazenar M^1 + M^2 + M^3 + ... M^(n_vertices-1) */
-  matriz_soma = (long int *) malloc(sizeof(long int) * n_vertices * n_vertices);
+  /* Se uma busca em largura a partir do vértice 0 alcança todos os vértices, então
+     existe caminho de 0 a qualquer vértice, e portanto entre quaisquer dois vértices */
+  alcancados = busca_largura(c, g->grafo_adjacencia_inicio, g->grafo_adjacencia, 0, n_vertices);
 
-  /* Se for nula, retorna erro de alocação dinâmica */
-  if(matriz_soma == NULL) {
-    free(matriz_potencia);
-    fprintf(stderr, "conexo(): Erro ao alocar memória para matriz acumulativa!\n");
-    return -1;
+  /* Em grafos direcionados, também é preciso que todos os vértices alcancem 0, o que
+     é verificado com uma busca sobre os arcos invertidos */
+  if(alcancados == n_vertices && g->grafo_direcionado) {
+    alcancados = busca_largura(c, g->grafo_reversa_inicio, g->grafo_reversa, 0, n_vertices);
   }
 
-  /* Inicializa matriz_potencia <- M^1 e matriz_soma <- M, sendo M a matriz de adjacência do grafo */
-  for(i = 0; i < n_vertices * n_vertices; ++i) {
-    matriz_potencia[i] = g->grafo_matriz[i];
-    matriz_soma[i] = g->grafo_matriz[i];
-  }
+  devolver_contexto(g, c, posicao);
 
-  /* Multiplica a matriz_potencia por M aumentando seu grau, ou seja, se matriz_potencia = M^x, então
-     matriz_potencia <- M^(x+1), e soma M^(x+1) à matriz_soma */
-  for(i = 0; i < n_vertices - 1; ++i) {
-    multiplicar_matriz_quadrada(&matriz_potencia, g->grafo_matriz, n_vertices);
-    somar_matriz_quadrada(matriz_soma, matriz_potencia, n_vertices);
-  }
-
-  /* Incrementa os valores da diagonal principal do grafo, pois todos os vetores são
-     alcançáveis por si mesmos, aqui se soma M^0 */
-  for(i = 0; i < n_vertices; ++i) {
-    matriz_soma[i * n_vertices + i]++;
-  }
-
-  /* Libera memória ocupada pela matriz exponencial */
-  free(matriz_potencia);
-
-  /* Como M^n possui valores definidos em i,j onde existe passeio de tamanho n entre os vértices i e j,
-     então M^1 + M^2 + ... + M^(n_vertices-1) = matriz_soma possui valores definidos entre vértices onde
-     existe passeio entre os mesmos. Logo se há um valor nulo, o grafo não é conexo */
-  for(i = 0; i < n_vertices; ++i) {
-    for(j = 0; j < n_vertices; ++j) {
-      if(matriz_soma[i * n_vertices + j] == 0) {
-        /* Libera memória ocupada pela matriz acumulativa */
-        free(matriz_soma);
-        return 0;
-      }
-    }
-  }
-
-  /* Libera memória ocupada pela matriz acumulativa */
-  free(matriz_soma);
-  return 1;
+  return alcancados == n_vertices;
 }
 //------------------------------------------------------------------------------
 int fortemente_conexo(grafo g) {
   /* O procedimento usado é o mesmo para verificar se um grafo não direcionado é conexo,
-     a diferença é que a matriz é assimétrica pois cada arco é utilizado apenas em um sentido
-     (e não nos dois como nas arestas), portanto, utilizando a função conexo é possível verificar
+     a diferença é que em grafos direcionados a função conexo também faz a busca sobre
+     os arcos invertidos, portanto, utilizando a função conexo é possível verificar
      se o grafo também é fortemente conexo */
   return conexo(g);
 }
 //------------------------------------------------------------------------------
 long int diametro(grafo g) {
-  long int max = 0;
-  long int *matriz_distancias;
-  unsigned int n_vertices, i;
+  long int max = 0, excentricidade, *matriz_distancias;
+  unsigned int n_vertices, alcancados, i;
+  int erro = 0, paralelo;
 
-  /* Gera matriz de distâncias */
-  matriz_distancias = gerar_matriz_distancias(g);
   /* Número de vértices do grafo */
   n_vertices = g->grafo_n_vertices;
 
-  /* Percorre toda a matriz de distâncias e obtêm o valor máximo (exceto infinito) */
-  if(matriz_distancias != NULL) {
+  /* Reserva as threads antes de escolher o método, pois o custo de cada um depende de
+     quantas threads podem ser usadas */
+  paralelo = reservar_paralelismo(g);
+
+  /* Em grafos pequenos e densos, obtém o valor máximo (exceto infinito) da matriz
+     de distâncias calculada pelo Floyd-Warshall */
+  if(usar_floyd_warshall(g, paralelo)) {
+    matriz_distancias = floyd_warshall_matriz_distancias(g, paralelo);
+    liberar_paralelismo(g, paralelo);
+
+    if(matriz_distancias == NULL) {
+      return -1;
+    }
+
     for(i = 0; i < n_vertices * n_vertices; ++i) {
       if(matriz_distancias[i] != infinito && max < matriz_distancias[i]) {
         max = matriz_distancias[i];
@@ -511,18 +916,83 @@ long int diametro(grafo g) {
 
     /* Libera memória ocupada pela matriz de distâncias */
     free(matriz_distancias);
+    return max;
+  }
+
+  /* Caso contrário, faz uma busca em largura a partir de cada vértice. O último vértice
+     colocado na fila é o mais distante da origem, portanto sua distância é a excentricidade
+     da origem, e o diâmetro é o valor máximo encontrado (exceto infinito) */
+  #pragma omp parallel private(alcancados, excentricidade) reduction(max:max) reduction(|:erro) if(paralelo)
+  {
+    contexto c;
+    int posicao;
+
+    c = obter_contexto(g, &posicao);
+
+    #pragma omp for schedule(dynamic, 16)
+    for(i = 0; i < n_vertices; ++i) {
+      if(c == NULL) {
+        erro = 1;
+        continue;
+      }
+
+      alcancados = busca_largura(c, g->grafo_adjacencia_inicio, g->grafo_adjacencia, i, n_vertices);
+      excentricidade = c->contexto_distancia[c->contexto_fila[alcancados - 1]];
+
+      if(max < excentricidade) {
+        max = excentricidade;
+      }
+    }
+
+    if(c != NULL) {
+      devolver_contexto(g, c, posicao);
+    }
+  }
+
+  liberar_paralelismo(g, paralelo);
+
+  /* Se alguma thread não obteve contexto de busca, retorna erro */
+  if(erro) {
+    return -1;
   }
 
   /* Retorna o valor máximo encontrado */
   return max;
 }
 //------------------------------------------------------------------------------
+long int distancia(grafo g, const char *u, const char *v) {
+  long int resultado;
+  int origem, destino, posicao;
+  contexto c;
+
+  /* Obtém os índices dos vértices, se algum não existe não há caminho entre eles */
+  origem = encontra_vertice(g->grafo_vertices, g->grafo_n_vertices, u);
+  destino = encontra_vertice(g->grafo_vertices, g->grafo_n_vertices, v);
+
+  if(origem == -1 || destino == -1) {
+    return infinito;
+  }
+
+  /* Obtém um contexto de busca livre, se não houver memória retorna erro */
+  if((c = obter_contexto(g, &posicao)) == NULL) {
+    return -1;
+  }
+
+  /* Busca em largura a partir de u, interrompida assim que v é alcançado */
+  busca_largura(c, g->grafo_adjacencia_inicio, g->grafo_adjacencia, (unsigned int) origem, (unsigned int) destino);
+  resultado = distancia_contexto(c, (unsigned int) destino);
+
+  devolver_contexto(g, c, posicao);
+
+  return resultado;
+}
+//------------------------------------------------------------------------------
 grafo distancias(grafo g) {
   grafo grafo_distancias;
   unsigned int n_vertices, i;
 
   /* Estrutura do grafo de distâncias */
-  grafo_distancias = (grafo) malloc(sizeof(struct grafo));
+  grafo_distancias = (grafo) calloc(1, sizeof(struct grafo));
   /* Número de vértices do grafo */
   n_vertices = g->grafo_n_vertices;
 
@@ -543,8 +1013,14 @@ grafo distancias(grafo g) {
       }
     }
 
-    /* Aloca matriz de adjacência do grafo de distâncias */
+    /* Aloca matriz de adjacência do grafo de distâncias e suas listas de adjacência,
+       para que o grafo devolvido também possa ser consultado */
     grafo_distancias->grafo_matriz = gerar_matriz_distancias(g);
+
+    if(grafo_distancias->grafo_matriz == NULL || !construir_listas_adjacencia(grafo_distancias) || !construir_conjunto_contextos(grafo_distancias)) {
+      destroi_grafo(grafo_distancias);
+      return NULL;
+    }
   }
 
   return grafo_distancias;
@@ -11,6 +11,22 @@
 // num grafo com pesos nas arestas todas as arestas tem peso, que 
 // 
 // o peso de uma aresta é um long int e seu valor default é zero
+//
+// depois de lido, o grafo não é mais alterado, portanto as funções de
+// consulta (conexo(), fortemente_conexo(), diametro(), distancia() e
+// distancias()) podem ser chamadas ao mesmo tempo por várias threads
+// sobre o mesmo grafo
+//
+// cada consulta usa um contexto de busca (vetores de marcas, fila e
+// distâncias) reservado de um conjunto mantido no próprio grafo, sem
+// travas; se todos estiverem em uso, um contexto temporário é alocado
+//
+// diametro() e distancias() consultam todos os pares de vértices e usam
+// as threads do OpenMP; se outra dessas consultas já as está usando no
+// mesmo grafo, a consulta é executada apenas na thread que a chamou
+//
+// le_grafo() e destroi_grafo() não podem ser executadas ao mesmo tempo
+// que outras funções sobre o mesmo grafo
 
 typedef struct grafo *grafo;
 
@@ -26,7 +42,7 @@ typedef struct vertice *vertice;
 //------------------------------------------------------------------------------
 // valor que representa "infinito"
 
-const long int infinito;
+extern const long int infinito;
 
 //------------------------------------------------------------------------------
 // lê um grafo no formato dot de input, usando as rotinas de libcgraph
@@ -68,6 +84,23 @@ char *nome(grafo g);
 
 unsigned int n_vertices(grafo g);
 
+//------------------------------------------------------------------------------
+// devolve o nome do i-ésimo vértice do grafo g, ou
+//         NULL, se g não tem i+1 vértices
+
+char *nome_vertice(grafo g, unsigned int i);
+
+//------------------------------------------------------------------------------
+// devolve o peso da aresta {u,v} (arco (u,v)) de g, entre os vértices de
+// nomes u e v, ou
+//         0, se a aresta (arco) não existe (ou se u ou v não são vértices de g)
+//
+// num grafo sem pesos nas arestas o peso de toda aresta é 1, e no grafo
+// devolvido por distancias() o peso de (u,u) é 0 e o de (u,v) é infinito
+// se v não é alcançável a partir de u
+
+long int peso_aresta(grafo g, const char *u, const char *v);
+
 //------------------------------------------------------------------------------
 // devolve 1, se g é direcionado, ou
 //         0, caso contrário
@@ -76,21 +109,33 @@ int direcionado(grafo g);
 
 //------------------------------------------------------------------------------
 // devolve 1, se g é conexo, ou
-//         0, caso contrário
+//         0, caso contrário, ou
+//        -1, em caso de erro
 
 int conexo(grafo g);
 
 //------------------------------------------------------------------------------
 // devolve 1, se g é fortemente conexo, ou
-//         0, caso contrário
+//         0, caso contrário, ou
+//        -1, em caso de erro
 
 int fortemente_conexo(grafo g);
 
 //------------------------------------------------------------------------------
-// devolve o diâmetro do grafo g
+// devolve o diâmetro do grafo g, ou
+//         -1, em caso de erro
 
 long int diametro(grafo g);
 
+//------------------------------------------------------------------------------
+// devolve a distância do vértice de nome u ao vértice de nome v em g,
+// entendida como tamanho (e não peso) do menor caminho de u a v, ou
+//         infinito, se v não é alcançável a partir de u em g
+//                   (ou se u ou v não são vértices de g), ou
+//         -1, em caso de erro
+
+long int distancia(grafo g, const char *u, const char *v);
+
 //------------------------------------------------------------------------------
 // devolve um grafo com pesos, onde
 //
@@ -102,6 +147,8 @@ long int diametro(grafo g);
 //
 //       neste caso, seu peso é a distância de u a v em g, entendida
 //       como tamanho (e não peso) do menor caminho de u a v em g
+//
+// devolve NULL em caso de erro
 
 grafo distancias(grafo g);
 
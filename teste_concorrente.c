@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "grafo.h"
+
+#define N_THREADS 8
+
+//------------------------------------------------------------------------------
+// respostas obtidas sem concorrência, comparadas com as de cada thread
+
+static grafo g;
+static int conexo_esperado;
+static long int diametro_esperado;
+static long int *distancias_esperadas;
+static int falhas[N_THREADS];
+
+//------------------------------------------------------------------------------
+// cada thread percorre todos os pares de vértices, começando em um ponto
+// diferente, e repete conexo() e diametro() periodicamente
+
+static void *consulta(void *argumento) {
+  unsigned int t = *(unsigned int *) argumento;
+  unsigned int n = n_vertices(g), i, par;
+
+  for (i = 0; i < n * n; ++i) {
+
+    par = (i + t * n * n / N_THREADS) % (n * n);
+
+    if ( distancia(g, nome_vertice(g, par / n), nome_vertice(g, par % n)) != distancias_esperadas[par] )
+
+      ++falhas[t];
+
+    if ( i % (n * n / 4 + 1) == 0 ) {
+
+      if ( conexo(g) != conexo_esperado )
+
+        ++falhas[t];
+
+      if ( diametro(g) != diametro_esperado )
+
+        ++falhas[t];
+    }
+  }
+
+  return NULL;
+}
+
+//------------------------------------------------------------------------------
+int main(void) {
+
+  pthread_t threads[N_THREADS];
+  unsigned int indices[N_THREADS], n, i, t;
+  long int maior = 0;
+  int total = 0, divergentes = 0, erro_todos_pares;
+  grafo d;
+
+  g = le_grafo(stdin);
+
+  if ( ! g )
+
+    return 1;
+
+  n = n_vertices(g);
+
+  distancias_esperadas = malloc(sizeof(long int) * n * n);
+
+  if ( ! distancias_esperadas )
+
+    return 1;
+
+  conexo_esperado = conexo(g);
+  diametro_esperado = diametro(g);
+
+  for (i = 0; i < n * n; ++i)
+
+    distancias_esperadas[i] = distancia(g, nome_vertice(g, i / n), nome_vertice(g, i % n));
+
+  // distancias() e diametro() calculam todas as distâncias pelo método
+  // escolhido para o grafo (buscas em largura ou Floyd-Warshall), e
+  // distancia() sempre por busca em largura, portanto cada distância
+  // do grafo de distâncias e o diâmetro devem concordar com distancia()
+
+  d = distancias(g);
+
+  if ( ! d )
+
+    return 1;
+
+  for (i = 0; i < n * n; ++i) {
+
+    if ( peso_aresta(d, nome_vertice(g, i / n), nome_vertice(g, i % n)) != distancias_esperadas[i] )
+
+      ++divergentes;
+
+    if ( distancias_esperadas[i] != infinito && distancias_esperadas[i] > maior )
+
+      maior = distancias_esperadas[i];
+  }
+
+  destroi_grafo(d);
+
+  erro_todos_pares = divergentes || maior != diametro_esperado;
+
+  if ( erro_todos_pares )
+
+    printf("%s: %d distâncias divergentes, diâmetro %ld (esperado %ld)\n", nome(g), divergentes, diametro_esperado, maior);
+
+  for (t = 0; t < N_THREADS; ++t) {
+
+    indices[t] = t;
+    pthread_create(&threads[t], NULL, consulta, &indices[t]);
+  }
+
+  for (t = 0; t < N_THREADS; ++t) {
+
+    pthread_join(threads[t], NULL);
+    total += falhas[t];
+  }
+
+  printf("%s: %d consultas concorrentes divergentes\n", nome(g), total);
+
+  free(distancias_esperadas);
+  destroi_grafo(g);
+
+  return total != 0 || erro_todos_pares;
+}